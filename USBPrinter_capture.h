@@ -0,0 +1,141 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2018 gdsports625@gmail.com
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+/* USB printer transfer capture
+ * Header only. When attached with USBPrinter::setCapture() every bulk OUT
+ * transfer the driver queues and every bulk IN transfer that returns data
+ * is recorded into a circular buffer supplied by the sketch. Recording runs
+ * in the USB interrupt, so the sketch drains the buffer from loop() to a
+ * Print (SD card File, Serial, ...):
+ *
+ *   uint8_t capbuf[8192];
+ *   USBPrinterCapture capture(capbuf, sizeof(capbuf));
+ *   uprinter.setCapture(&capture);
+ *   ...
+ *   capture.drain(logfile);
+ *
+ * Records that do not fit are dropped and counted, see dropped().
+ *
+ * Log format, all values little endian:
+ *   file header  'U' 'P' 'C' '1'
+ *   record       uint32_t timestamp   micros() when queued (OUT) or completed (IN)
+ *                uint16_t length      bits 0-14 payload length, bit 15 set for IN
+ *                uint8_t  payload[length]
+ *
+ * extras/replay feeds a log back through the driver on a host.
+ */
+
+#ifndef USBPrinter_capture_h_
+#define USBPrinter_capture_h_
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+
+class USBPrinterCapture {
+	public:
+	enum { DIR_OUT = 0, DIR_IN = 1 };
+	enum { RECORD_HEADER_SIZE = 6, MAX_PAYLOAD = 0x7FFF, LENGTH_IN = 0x8000 };
+	USBPrinterCapture(uint8_t *buffer, uint32_t size) :
+		buf(buffer), bufsize(size), head(0), tail(0), dropped_count(0), started(false) {}
+	// Append one record, called from the USB interrupt
+	bool record(uint32_t timestamp, uint8_t dir, const uint8_t *data, uint32_t len) {
+		if (len > MAX_PAYLOAD) {
+			dropped_count++;
+			return false;
+		}
+		uint32_t h = head;
+		uint32_t t = tail;
+		uint32_t avail;
+		if (h >= t) {
+			avail = bufsize - 1 - h + t;
+		} else {
+			avail = t - h - 1;
+		}
+		if (avail < RECORD_HEADER_SIZE + len) {
+			dropped_count++;
+			return false;
+		}
+		if (dir == DIR_IN) len |= LENGTH_IN;
+		uint8_t hdr[RECORD_HEADER_SIZE] = {
+			(uint8_t)timestamp, (uint8_t)(timestamp >> 8),
+			(uint8_t)(timestamp >> 16), (uint8_t)(timestamp >> 24),
+			(uint8_t)len, (uint8_t)(len >> 8)
+		};
+		h = put(h, hdr, RECORD_HEADER_SIZE);
+		h = put(h, data, len & MAX_PAYLOAD);
+		head = h;
+		return true;
+	}
+	// Number of log bytes waiting to be drained
+	uint32_t available() {
+		uint32_t h = head;
+		uint32_t t = tail;
+		if (h >= t) return h - t;
+		return bufsize + h - t;
+	}
+	uint32_t dropped() { return dropped_count; }
+	// Write waiting log bytes to out, preceded by the file header on the
+	// first call. Returns the number of bytes written.
+	template <class Out>
+	size_t drain(Out &out) {
+		size_t n = 0;
+		if (!started) {
+			static const uint8_t magic[4] = { 'U', 'P', 'C', '1' };
+			n += out.write(magic, sizeof(magic));
+			started = true;
+		}
+		uint32_t h = head;
+		uint32_t t = tail;
+		if (h < t) {
+			n += out.write(buf + t, bufsize - t);
+			t = 0;
+		}
+		if (h > t) {
+			n += out.write(buf + t, h - t);
+			t = h;
+		}
+		tail = t;
+		return n;
+	}
+	private:
+	// copy into the circular buffer at offset h, returns the new offset
+	uint32_t put(uint32_t h, const uint8_t *p, uint32_t n) {
+		uint32_t first = bufsize - h;
+		if (first > n) first = n;
+		memcpy(buf + h, p, first);
+		if (n > first) memcpy(buf, p + first, n - first);
+		h += n;
+		if (h >= bufsize) h -= bufsize;
+		return h;
+	}
+	uint8_t *buf;
+	uint32_t bufsize;
+	volatile uint32_t head;	// next byte to write
+	volatile uint32_t tail;	// next byte to drain
+	volatile uint32_t dropped_count;
+	bool started;
+};
+
+#endif
@@ -0,0 +1,140 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2018 gdsports625@gmail.com
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+/* Grayscale to 1 bit per pixel conversion for raster printing
+ * This file does not depend on Arduino so the kernels can be built and
+ * benchmarked on a host, see extras/dither_bench.
+ */
+
+#include "USBPrinter_dither.h"
+
+// 8x8 Bayer matrix, scaled to thresholds 2..254
+static const uint8_t bayer8[8][8] __attribute__ ((aligned(4))) = {
+	{   2, 130,  34, 162,  10, 138,  42, 170 },
+	{ 194,  66, 226,  98, 202,  74, 234, 106 },
+	{  50, 178,  18, 146,  58, 186,  26, 154 },
+	{ 242, 114, 210,  82, 250, 122, 218,  90 },
+	{  14, 142,  46, 174,   6, 134,  38, 166 },
+	{ 206,  78, 238, 110, 198,  70, 230, 102 },
+	{  62, 190,  30, 158,  54, 182,  22, 150 },
+	{ 254, 126, 222,  94, 246, 118, 214,  86 }
+};
+
+#if defined(__ARM_FEATURE_DSP)
+// Packed black dot bits for 4 pixels. usub8 sets the GE flag of each byte
+// lane where pixel >= threshold (white), sel keeps the bit weight of the
+// black lanes and usad8 adds the lanes together.
+static inline uint32_t dark_bits4(uint32_t pixels, uint32_t thresholds, uint32_t weights)
+{
+	uint32_t r;
+	asm ("usub8 %0, %1, %2\n\t"
+		"sel %0, %3, %4\n\t"
+		"usad8 %0, %0, %3"
+		: "=&r" (r)
+		: "r" (pixels), "r" (thresholds), "r" (0), "r" (weights)
+		: "cc");
+	return r;
+}
+#endif
+
+// Compare each pixel against thresholds[x & 7]
+static void ordered_row(const uint8_t *gray, uint8_t *packed, uint32_t width,
+	const uint8_t *thresholds)
+{
+	uint32_t count = width >> 3;
+#if defined(__ARM_FEATURE_DSP)
+	uint32_t t0, t1;
+	memcpy(&t0, thresholds, 4);
+	memcpy(&t1, thresholds + 4, 4);
+	while (count--) {
+		uint32_t p0, p1;
+		memcpy(&p0, gray, 4);	// unaligned loads are fine on Cortex-M4/M7
+		memcpy(&p1, gray + 4, 4);
+		*packed++ = dark_bits4(p0, t0, 0x10204080) | dark_bits4(p1, t1, 0x01020408);
+		gray += 8;
+	}
+#else
+	while (count--) {
+		uint32_t b = 0;
+		for (int i = 0; i < 8; i++) {
+			b = (b << 1) | (gray[i] < thresholds[i]);
+		}
+		*packed++ = b;
+		gray += 8;
+	}
+#endif
+	uint32_t rem = width & 7;
+	if (rem) {
+		uint32_t b = 0;
+		for (uint32_t i = 0; i < rem; i++) {
+			if (gray[i] < thresholds[i]) b |= 0x80 >> i;
+		}
+		*packed = b;
+	}
+}
+
+void dither_threshold_row(const uint8_t *gray, uint8_t *packed, uint32_t width, uint8_t threshold)
+{
+	uint8_t thresholds[8] __attribute__ ((aligned(4)));
+	memset(thresholds, threshold, sizeof(thresholds));
+	ordered_row(gray, packed, width, thresholds);
+}
+
+void dither_bayer_row(const uint8_t *gray, uint8_t *packed, uint32_t width, uint32_t y)
+{
+	ordered_row(gray, packed, width, bayer8[y & 7]);
+}
+
+void dither_fs_row(const uint8_t *gray, uint8_t *packed, uint32_t width,
+	const int16_t *err_in, int16_t *err_out)
+{
+	// Error terms are kept in 1/16 units so the 7/16, 3/16, 5/16 and 1/16
+	// weights are integer multiplies.  Entry x + 1 belongs to pixel x.
+	// The error to the right is carried in a register and the entry below
+	// right is assigned rather than added, so err_out needs no clearing.
+	int32_t carry = 0;
+	uint32_t b = 0;
+	err_out[0] = 0;
+	err_out[1] = 0;
+	for (uint32_t x = 0; x < width; x++) {
+		int32_t v = gray[x] + ((err_in[x + 1] + carry + 8) >> 4);
+		int32_t e;
+		b <<= 1;
+		if (v < 128) {
+			b |= 1;
+			e = v;
+		} else {
+			e = v - 255;
+		}
+		carry = e * 7;
+		err_out[x] += e * 3;
+		err_out[x + 1] += e * 5;
+		err_out[x + 2] = e;
+		if ((x & 7) == 7) {
+			*packed++ = b;
+			b = 0;
+		}
+	}
+	if (width & 7) *packed = b << (8 - (width & 7));
+}
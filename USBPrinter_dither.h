@@ -0,0 +1,112 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2018 gdsports625@gmail.com
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+/* Grayscale to 1 bit per pixel conversion for raster printing
+ * Images are converted one row at a time so only the current row, its
+ * packed output and (for Floyd-Steinberg) two rows of error terms are
+ * held in RAM.
+ *
+ * gray rows are 8 bits per pixel, 0 = black, 255 = white.
+ * packed rows are (width + 7) / 8 bytes, MSB first, 1 = black dot, the same
+ * layout as the ESC/POS raster bit image command. Unused bits in the last
+ * byte are 0.
+ *
+ * On Cortex-M4/M7 (Teensy 3.6, 4.x) the threshold and ordered kernels use
+ * the DSP extension SIMD instructions to handle 4 pixels per instruction.
+ * Other targets, including host builds, use the portable C code.
+ */
+
+#ifndef USBPrinter_dither_h_
+#define USBPrinter_dither_h_
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include "USBPrinter_escpos.h"
+
+// black where gray < threshold
+void dither_threshold_row(const uint8_t *gray, uint8_t *packed, uint32_t width, uint8_t threshold);
+// 8x8 Bayer ordered dither, y is the row number in the image
+void dither_bayer_row(const uint8_t *gray, uint8_t *packed, uint32_t width, uint32_t y);
+// Floyd-Steinberg error diffusion. err_in holds the error carried into
+// this row, err_out receives the error for the next row. Both are
+// width + 2 entries, in 1/16 units, and are swapped by the caller after
+// each row. err_out is completely overwritten so it needs no clearing.
+void dither_fs_row(const uint8_t *gray, uint8_t *packed, uint32_t width,
+	const int16_t *err_in, int16_t *err_out);
+
+// Row streaming converter for images up to WIDTH pixels wide
+//
+//   USBPrinterDither<384> dither(USBPrinterDither<384>::FLOYD_STEINBERG);
+//   dither.begin(uprinter, height);
+//   for (each row) dither.writeRow(uprinter, gray_row);
+//
+// Rows go to the printer with write(buffer, size) so each one is a single
+// copy into the USBPrinter transmit buffer.
+template <uint16_t WIDTH>
+class USBPrinterDither {
+	public:
+	enum Method { THRESHOLD, BAYER, FLOYD_STEINBERG };
+	enum { ROW_BYTES = (WIDTH + 7) / 8 };
+	USBPrinterDither(Method m = FLOYD_STEINBERG, uint8_t thresh = 128) :
+		method(m), threshold(thresh) { reset(); }
+	void reset() {
+		y = 0;
+		memset(err, 0, sizeof(err));
+	}
+	// Convert one row of WIDTH pixels, returns ROW_BYTES of packed data
+	const uint8_t *row(const uint8_t *gray) {
+		switch (method) {
+			case THRESHOLD:
+				dither_threshold_row(gray, packed, WIDTH, threshold);
+				break;
+			case BAYER:
+				dither_bayer_row(gray, packed, WIDTH, y);
+				break;
+			default:
+				dither_fs_row(gray, packed, WIDTH, err[y & 1], err[(y & 1) ^ 1]);
+				break;
+		}
+		y++;
+		return packed;
+	}
+	// Send the raster image header for height rows and start a new image
+	template <class Out>
+	size_t begin(Out &out, uint16_t height) {
+		reset();
+		return escpos::write(out, escpos::raster(ROW_BYTES, height));
+	}
+	template <class Out>
+	size_t writeRow(Out &out, const uint8_t *gray) {
+		return out.write(row(gray), ROW_BYTES);
+	}
+	private:
+	int16_t err[2][WIDTH + 2];
+	uint8_t packed[ROW_BYTES];
+	uint16_t y;
+	Method method;
+	uint8_t threshold;
+};
+
+#endif
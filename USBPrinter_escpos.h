@@ -0,0 +1,170 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2018 gdsports625@gmail.com
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+/* ESC/POS command builder
+ * Header only, requires C++14. Every function is constexpr so fixed command
+ * sequences are encoded by the compiler as constant data, for example
+ *
+ *   static constexpr auto HEADER = escpos::initialize() +
+ *       escpos::justify(escpos::CENTER) + escpos::charSize(2, 2) +
+ *       escpos::text("RECEIPT\n");
+ *   escpos::write(uprinter, HEADER);
+ *
+ * escpos::write() hands the whole sequence to write(buffer, size) so it is
+ * copied into the USBPrinter transmit buffer in one go.
+ *
+ * Constant data stays in flash on Teensy 3.6. On Teensy 4.x it is copied
+ * to RAM at startup.
+ *
+ * Reference: Epson ESC/POS Application Programming Guide
+ */
+
+#ifndef USBPrinter_escpos_h_
+#define USBPrinter_escpos_h_
+
+#include <stdint.h>
+#include <stddef.h>
+
+namespace escpos {
+
+enum { ESC = 0x1B, GS = 0x1D, LF = 0x0A };
+
+// Fixed length command sequence
+template <size_t N>
+struct Command {
+	uint8_t bytes[N];
+	constexpr size_t size() const { return N; }
+	constexpr const uint8_t *data() const { return bytes; }
+	constexpr uint8_t operator[](size_t i) const { return bytes[i]; }
+};
+
+// Join two sequences, evaluated at compile time for constexpr operands
+template <size_t N, size_t M>
+constexpr Command<N + M> operator+(const Command<N> &a, const Command<M> &b)
+{
+	Command<N + M> r{};
+	for (size_t i = 0; i < N; i++) r.bytes[i] = a.bytes[i];
+	for (size_t i = 0; i < M; i++) r.bytes[N + i] = b.bytes[i];
+	return r;
+}
+
+// Send a sequence as a single write(buffer, size) call
+template <class Out, size_t N>
+inline size_t write(Out &out, const Command<N> &cmd)
+{
+	return out.write(cmd.bytes, N);
+}
+
+// Raw bytes from a string literal, without the terminating null
+template <size_t N>
+constexpr Command<N - 1> text(const char (&s)[N])
+{
+	Command<N - 1> r{};
+	for (size_t i = 0; i < N - 1; i++) r.bytes[i] = (uint8_t)s[i];
+	return r;
+}
+
+constexpr Command<1> bytes(uint8_t a) { return {{a}}; }
+constexpr Command<2> bytes(uint8_t a, uint8_t b) { return {{a, b}}; }
+constexpr Command<3> bytes(uint8_t a, uint8_t b, uint8_t c) { return {{a, b, c}}; }
+constexpr Command<4> bytes(uint8_t a, uint8_t b, uint8_t c, uint8_t d) { return {{a, b, c, d}}; }
+
+/************************************************************/
+//  Printer setup and text formatting
+/************************************************************/
+
+enum Justify { LEFT = 0, CENTER = 1, RIGHT = 2 };
+enum Font { FONT_A = 0, FONT_B = 1 };
+enum Underline { UNDERLINE_OFF = 0, UNDERLINE_1DOT = 1, UNDERLINE_2DOT = 2 };
+
+constexpr Command<2> initialize() { return bytes(ESC, '@'); }		// ESC @
+constexpr Command<1> lineFeed() { return bytes(LF); }
+constexpr Command<3> justify(Justify j) { return bytes(ESC, 'a', j); }	// ESC a n
+constexpr Command<3> font(Font f) { return bytes(ESC, 'M', f); }		// ESC M n
+constexpr Command<3> bold(bool on) { return bytes(ESC, 'E', on); }		// ESC E n
+constexpr Command<3> underline(Underline u) { return bytes(ESC, '-', u); }	// ESC - n
+constexpr Command<3> inverse(bool on) { return bytes(GS, 'B', on); }		// GS B n
+constexpr Command<3> upsideDown(bool on) { return bytes(ESC, '{', on); }	// ESC { n
+constexpr Command<3> lineSpacing(uint8_t dots) { return bytes(ESC, '3', dots); }	// ESC 3 n
+constexpr Command<2> defaultLineSpacing() { return bytes(ESC, '2'); }	// ESC 2
+constexpr Command<3> feed(uint8_t lines) { return bytes(ESC, 'd', lines); }	// ESC d n
+
+// Character width and height multipliers, 1..8 each. GS ! n
+constexpr Command<3> charSize(uint8_t width, uint8_t height)
+{
+	return bytes(GS, '!', (uint8_t)((((width - 1) & 7) << 4) | ((height - 1) & 7)));
+}
+
+// Cut immediately. GS V m
+constexpr Command<3> cut(bool partial = false) { return bytes(GS, 'V', partial ? 1 : 0); }
+
+// Feed to the cutter plus lines * line spacing, then cut. GS V m n
+constexpr Command<4> feedCut(uint8_t lines, bool partial = false)
+{
+	return bytes(GS, 'V', partial ? 66 : 65, lines);
+}
+
+/************************************************************/
+//  Barcodes
+/************************************************************/
+
+enum Barcode {
+	UPC_A = 65, UPC_E = 66, EAN13 = 67, EAN8 = 68, CODE39 = 69,
+	ITF = 70, CODABAR = 71, CODE93 = 72, CODE128 = 73
+};
+enum HRI { HRI_NONE = 0, HRI_ABOVE = 1, HRI_BELOW = 2, HRI_BOTH = 3 };
+
+constexpr Command<3> barcodeHeight(uint8_t dots) { return bytes(GS, 'h', dots); }	// GS h n
+constexpr Command<3> barcodeWidth(uint8_t module) { return bytes(GS, 'w', module); }	// GS w n
+constexpr Command<3> barcodeHRI(HRI pos) { return bytes(GS, 'H', pos); }		// GS H n
+
+// Barcode header, followed by length bytes of barcode data. GS k m n
+constexpr Command<4> barcode(Barcode type, uint8_t length)
+{
+	return bytes(GS, 'k', type, length);
+}
+
+// Complete barcode from a string literal
+template <size_t N>
+constexpr Command<N + 3> barcode(Barcode type, const char (&data)[N])
+{
+	return barcode(type, (uint8_t)(N - 1)) + text(data);
+}
+
+/************************************************************/
+//  Raster graphics
+/************************************************************/
+
+// Raster bit image header, followed by widthBytes * height bytes of 1bpp
+// data, MSB first, 1 = black dot. mode: 0 normal, 1 double width,
+// 2 double height, 3 quadruple. GS v 0 m xL xH yL yH
+constexpr Command<8> raster(uint16_t widthBytes, uint16_t height, uint8_t mode = 0)
+{
+	return bytes(GS, 'v', '0', mode) +
+		bytes(widthBytes & 0xFF, widthBytes >> 8, height & 0xFF, height >> 8);
+}
+
+} // namespace escpos
+
+#endif
@@ -59,6 +59,7 @@
 #include <Arduino.h>
 #include "USBHost_t36.h"  // Read this header first for key info
 #include "USBPrinter_t36.h"
+#include "USBPrinter_capture.h"
 
 #define print   USBHost::print_
 #define println USBHost::println_
@@ -271,6 +272,8 @@ void USBPrinter::rx_data(const Transfer_t *transfer)
 		println(" ", *(p+1), HEX);
 		print("rx: ");
 		print_hexbytes(p, len);
+		USBPrinterCapture *cap = capture;
+		if (cap) cap->record(micros(), USBPrinterCapture::DIR_IN, p, len);
 	}
 	// Copy data from packet buffer to circular buffer.
 	// Assume the buffer will always have space, since we
@@ -364,7 +367,7 @@ void USBPrinter::tx_data(const Transfer_t *transfer)
 	}
 	// immediately transmit another full packet, if we have enough data
 	if (count >= packetsize) count = packetsize;
-	else txstate &= ~(mask | 4); // This packet will complete any outstanding flush
+	else txstate &= ~4; // This packet will complete any outstanding flush, buffer stays busy until it is sent
 
 	println("TX:moar data!!!!");
 	if (++tail >= txsize) tail = 0;
@@ -380,7 +383,15 @@ void USBPrinter::tx_data(const Transfer_t *transfer)
 		tail = len - 1;
 	}
 	txtail = tail;
-	queue_Data_Transfer(txpipe, p, count, this);
+	tx_queue(p, count);
+}
+
+// queue a tx packet buffer, recording it first if capture is enabled
+void USBPrinter::tx_queue(uint8_t *p, uint32_t len)
+{
+	USBPrinterCapture *cap = capture;
+	if (cap) cap->record(micros(), USBPrinterCapture::DIR_OUT, p, len);
+	queue_Data_Transfer(txpipe, p, len, this);
 }
 
 void USBPrinter::flush()
@@ -453,7 +464,7 @@ void USBPrinter::timer_event(USBDriverTimer *whichTimer)
 	print("  TX data (", count);
 	print(") ");
 	print_hexbytes(p, count);
-	queue_Data_Transfer(txpipe, p, count, this);
+	tx_queue(p, count);
 }
 
 
@@ -545,53 +556,98 @@ size_t USBPrinter::write(uint8_t c)
 
 	// if full packet in buffer and tx packet ready, queue it
 	NVIC_DISABLE_IRQ(IRQ_USBHS);
-	uint32_t tail = txtail;
-	if ((txstate & 0x03) != 0x03) {
-		// at least one packet buffer is ready to transmit
-		uint32_t count;
+	if (tx_queue_packet(head)) {
+		NVIC_ENABLE_IRQ(IRQ_USBHS);
+		return 1;
+	}
+	// otherwise, set a latency timer to later transmit partial packet
+	txtimer.stop();
+	txtimer.start(write_timeout_);
+	NVIC_ENABLE_IRQ(IRQ_USBHS);
+	return 1;
+}
+
+size_t USBPrinter::write(const uint8_t *buffer, size_t size)
+{
+	if (!device) return 0;
+	size_t remaining = size;
+	while (remaining > 0) {
+		uint32_t head = txhead;
+		uint32_t tail = txtail;
+		uint32_t avail;
 		if (head >= tail) {
-			count = head - tail;
+			avail = txsize - 1 - head + tail;
 		} else {
-			count = txsize + head - tail;
-		}
-		uint32_t packetsize = tx2 - tx1;
-		if (count >= packetsize) {
-			//println("txsize=", txsize);
-			uint8_t *p;
-			if ((txstate & 0x01) == 0) {
-				p = tx1;
-				txstate |= 0x01;
-			} else /* if ((txstate & 0x02) == 0) */ {
-				p = tx2;
-				txstate |= 0x02;
-			}
-			// copy data to packet buffer
-			if (++tail >= txsize) tail = 0;
-			uint32_t n = txsize - tail;
-			if (n > packetsize) n = packetsize;
-			//print("memcpy, offset=", tail);
-			//println(", len=", n);
-			memcpy(p, txbuf + tail, n);
-			if (n >= packetsize) {
-				tail += n - 1;
-				if (tail >= txsize) tail = 0;
-			} else {
-				//n = txsize - n;
-				uint32_t len = packetsize - n;
-				//println("memcpy, offset=0, len=", len);
-				memcpy(p + n, txbuf, len);
-				tail = len - 1;
-			}
-			txtail = tail;
-			//println("queue tx packet, newtail=", tail);
-			queue_Data_Transfer(txpipe, p, packetsize, this);
-			NVIC_ENABLE_IRQ(IRQ_USBHS);
-			return 1;
+			avail = tail - head - 1;
 		}
+		if (avail == 0) continue;	// wait...
+		// copy as much as fits up to the end of the circular buffer
+		if (++head >= txsize) head = 0;
+		uint32_t n = txsize - head;
+		if (n > avail) n = avail;
+		if (n > remaining) n = remaining;
+		memcpy(txbuf + head, buffer, n);
+		head += n - 1;
+		txhead = head;
+		buffer += n;
+		remaining -= n;
+
+		// queue full packets while tx packet buffers are ready
+		NVIC_DISABLE_IRQ(IRQ_USBHS);
+		while (tx_queue_packet(head)) ;
+		NVIC_ENABLE_IRQ(IRQ_USBHS);
 	}
-	// otherwise, set a latency timer to later transmit partial packet
+	// set a latency timer to later transmit any partial packet
+	NVIC_DISABLE_IRQ(IRQ_USBHS);
 	txtimer.stop();
 	txtimer.start(write_timeout_);
 	NVIC_ENABLE_IRQ(IRQ_USBHS);
-	return 1;
+	return size;
+}
+
+// queue one full packet from the transmit buffer, if a tx packet buffer
+// is ready.  Must be called with the USBHS IRQ disabled.
+bool USBPrinter::tx_queue_packet(uint32_t head)
+{
+	if ((txstate & 0x03) == 0x03) return false;
+	// at least one packet buffer is ready to transmit
+	uint32_t tail = txtail;
+	uint32_t count;
+	if (head >= tail) {
+		count = head - tail;
+	} else {
+		count = txsize + head - tail;
+	}
+	uint32_t packetsize = tx2 - tx1;
+	if (count < packetsize) return false;
+	//println("txsize=", txsize);
+	uint8_t *p;
+	if ((txstate & 0x01) == 0) {
+		p = tx1;
+		txstate |= 0x01;
+	} else /* if ((txstate & 0x02) == 0) */ {
+		p = tx2;
+		txstate |= 0x02;
+	}
+	// copy data to packet buffer
+	if (++tail >= txsize) tail = 0;
+	uint32_t n = txsize - tail;
+	if (n > packetsize) n = packetsize;
+	//print("memcpy, offset=", tail);
+	//println(", len=", n);
+	memcpy(p, txbuf + tail, n);
+	if (n >= packetsize) {
+		tail += n - 1;
+		if (tail >= txsize) tail = 0;
+	} else {
+		//n = txsize - n;
+		uint32_t len = packetsize - n;
+		//println("memcpy, offset=0, len=", len);
+		memcpy(p + n, txbuf, len);
+		tail = len - 1;
+	}
+	txtail = tail;
+	//println("queue tx packet, newtail=", tail);
+	tx_queue(p, packetsize);
+	return true;
 }
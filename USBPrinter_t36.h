@@ -55,6 +55,8 @@ SOFTWARE.
  *
  */
 
+class USBPrinterCapture;
+
 class USBPrinter: public USBDriver, public Stream {
 	public:
 
@@ -66,11 +68,13 @@ class USBPrinter: public USBDriver, public Stream {
 	void end(void);
 	uint32_t writeTimeout() {return write_timeout_;}
 	void writeTimeOut(uint32_t write_timeout) {write_timeout_ = write_timeout;} // Will not impact current ones.
+	void setCapture(USBPrinterCapture *cap) {capture = cap;} // Record transfers, NULL to stop. See USBPrinter_capture.h
 	virtual int available(void);
 	virtual int peek(void);
 	virtual int read(void);
 	virtual int availableForWrite();
 	virtual size_t write(uint8_t c);
+	virtual size_t write(const uint8_t *buffer, size_t size);
 	virtual void flush(void);
 
 	using Print::write;
@@ -84,6 +88,8 @@ private:
 	void rx_data(const Transfer_t *transfer);
 	void tx_data(const Transfer_t *transfer);
 	void rx_queue_packets(uint32_t head, uint32_t tail);
+	bool tx_queue_packet(uint32_t head);
+	void tx_queue(uint8_t *p, uint32_t len);
 	void init();
 	static bool check_rxtx_ep(uint32_t &rxep, uint32_t &txep);
 	bool init_buffers(uint32_t rsize, uint32_t tsize);
@@ -98,6 +104,7 @@ private:
 	setup_t setalternate;
 	uint8_t setupdata[16]; //
 	uint32_t write_timeout_ = DEFAULT_WRITE_TIMEOUT;
+	USBPrinterCapture * volatile capture = NULL;
 	Pipe_t *rxpipe;
 	Pipe_t *txpipe;
 	uint8_t *rx1;	// location for first incoming packet
@@ -0,0 +1,51 @@
+// Print a receipt using compile time ESC/POS command sequences
+//
+// This example is in the public domain
+
+#include "USBHost_t36.h"
+#include "USBPrinter_t36.h"
+#include "USBPrinter_escpos.h"
+
+USBHost myusb;
+USBHub hub1(myusb);
+USBPrinter uprinter(myusb);
+
+// Encoded by the compiler, sent to the printer with one write() each
+static constexpr auto HEADER = escpos::initialize() +
+  escpos::justify(escpos::CENTER) + escpos::charSize(2, 2) + escpos::bold(true) +
+  escpos::text("RECEIPT\n") +
+  escpos::charSize(1, 1) + escpos::bold(false) + escpos::justify(escpos::LEFT);
+static constexpr auto BARCODE = escpos::justify(escpos::CENTER) +
+  escpos::barcodeHeight(80) + escpos::barcodeHRI(escpos::HRI_BELOW) +
+  escpos::barcode(escpos::EAN13, "400638133393");
+static constexpr auto FOOTER = escpos::justify(escpos::LEFT) + escpos::feedCut(3);
+
+bool printer_active = false;
+
+void setup()
+{
+  while (!Serial && (millis() < 5000)) ; // wait for Arduino Serial Monitor
+  Serial.println("\n\nUSB Host Testing - Receipt");
+  myusb.begin();
+}
+
+void loop()
+{
+  myusb.Task();
+  if (uprinter != printer_active) {
+    printer_active = uprinter;
+    if (printer_active) {
+      Serial.println("*** Printer connected ***");
+      uprinter.begin();
+      escpos::write(uprinter, HEADER);
+      for (int i = 1; i <= 3; i++) {
+        uprinter.printf("Item %d%20s\n", i, "1.00");
+      }
+      escpos::write(uprinter, BARCODE);
+      escpos::write(uprinter, FOOTER);
+      uprinter.flush();
+    } else {
+      Serial.println("*** Printer disconnected ***");
+    }
+  }
+}
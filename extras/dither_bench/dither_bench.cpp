@@ -0,0 +1,88 @@
+/* Host benchmark for the USBPrinter_dither kernels
+ *
+ * Build and run from this directory:
+ *   g++ -O2 -I../.. dither_bench.cpp ../../USBPrinter_dither.cpp -o dither_bench
+ *   ./dither_bench [width] [height]
+ *
+ * Converts a synthetic gradient image with each kernel and reports
+ * pixels/sec plus the fraction of black dots as a sanity check (a
+ * left to right gradient should come out close to 50% black).
+ *
+ * This example is in the public domain
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <chrono>
+#include <vector>
+#include "USBPrinter_dither.h"
+
+enum Kernel { THRESHOLD, BAYER, FLOYD_STEINBERG };
+static const char *kernel_names[] = { "threshold", "bayer 8x8", "floyd-steinberg" };
+
+static uint32_t popcount_bytes(const uint8_t *p, uint32_t n)
+{
+	uint32_t count = 0;
+	while (n--) count += __builtin_popcount(*p++);
+	return count;
+}
+
+static void run(Kernel k, const std::vector<uint8_t> &image, uint32_t width, uint32_t height)
+{
+	uint32_t row_bytes = (width + 7) / 8;
+	std::vector<uint8_t> packed(row_bytes);
+	std::vector<int16_t> err0(width + 2, 0), err1(width + 2, 0);
+	uint64_t black = 0;
+	uint32_t passes = 0;
+	double elapsed = 0;
+	auto start = std::chrono::steady_clock::now();
+	// repeat the whole image until at least half a second has passed
+	do {
+		for (uint32_t y = 0; y < height; y++) {
+			const uint8_t *gray = &image[(size_t)y * width];
+			switch (k) {
+				case THRESHOLD:
+					dither_threshold_row(gray, packed.data(), width, 128);
+					break;
+				case BAYER:
+					dither_bayer_row(gray, packed.data(), width, y);
+					break;
+				case FLOYD_STEINBERG:
+					if (y & 1) dither_fs_row(gray, packed.data(), width, err1.data(), err0.data());
+					else dither_fs_row(gray, packed.data(), width, err0.data(), err1.data());
+					break;
+			}
+			if (passes == 0) black += popcount_bytes(packed.data(), row_bytes);
+		}
+		passes++;
+		elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	} while (elapsed < 0.5);
+	double pixels = (double)width * height * passes;
+	printf("%-16s %8.1f Mpixels/s  %5.1f%% black\n", kernel_names[k],
+		pixels / elapsed / 1e6, 100.0 * black / ((double)width * height));
+}
+
+int main(int argc, char **argv)
+{
+	uint32_t width = (argc > 1) ? atoi(argv[1]) : 576;
+	uint32_t height = (argc > 2) ? atoi(argv[2]) : 1024;
+	if (width == 0 || height == 0) {
+		fprintf(stderr, "usage: %s [width] [height]\n", argv[0]);
+		return 1;
+	}
+	// horizontal gradient plus a little noise so no kernel sees flat input
+	std::vector<uint8_t> image((size_t)width * height);
+	uint32_t seed = 1;
+	for (uint32_t y = 0; y < height; y++) {
+		for (uint32_t x = 0; x < width; x++) {
+			seed = seed * 1103515245 + 12345;
+			int v = (int)(x * 256 / width) + (int)((seed >> 16) & 15) - 8;
+			image[(size_t)y * width + x] = (v < 0) ? 0 : (v > 255) ? 255 : v;
+		}
+	}
+	printf("%u x %u pixels\n", width, height);
+	run(THRESHOLD, image, width, height);
+	run(BAYER, image, width, height);
+	run(FLOYD_STEINBERG, image, width, height);
+	return 0;
+}
@@ -0,0 +1,46 @@
+/* Minimal Arduino core for building USBPrinter_t36.cpp on a host
+ * Only what the driver uses. Part of extras/replay, see usbprinter_replay.cpp
+ *
+ * This example is in the public domain
+ */
+
+#ifndef Arduino_h
+#define Arduino_h
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include <utility>
+
+#define HEX 16
+#define DEC 10
+
+// The USB interrupt is a host thread, disabling it takes a lock
+#define IRQ_USBHS 0
+void NVIC_DISABLE_IRQ(int irq);
+void NVIC_ENABLE_IRQ(int irq);
+
+uint32_t micros(void);
+void yield(void);
+
+class Print {
+	public:
+	virtual size_t write(uint8_t b) = 0;
+	virtual size_t write(const uint8_t *buffer, size_t size) {
+		size_t count = 0;
+		while (size--) count += write(*buffer++);
+		return count;
+	}
+	virtual int availableForWrite(void) { return 0; }
+	virtual void flush() { }
+	virtual ~Print() { }
+};
+
+class Stream : public Print {
+	public:
+	virtual int available() = 0;
+	virtual int read() = 0;
+	virtual int peek() = 0;
+};
+
+#endif
@@ -0,0 +1,117 @@
+/* Virtual USB host for building USBPrinter_t36.cpp on a host
+ * Declares the parts of the USBHost_t36 API used by the printer driver.
+ * The implementation, a virtual host controller with a virtual printer
+ * attached, is in usbprinter_replay.cpp.
+ *
+ * This example is in the public domain
+ */
+
+#ifndef USB_HOST_TEENSY36_
+#define USB_HOST_TEENSY36_
+
+#include <Arduino.h>
+
+class USBHost;
+class USBDriver;
+class USBDriverTimer;
+typedef struct Device_struct    Device_t;
+typedef struct Pipe_struct      Pipe_t;
+typedef struct Transfer_struct  Transfer_t;
+
+struct Device_struct {
+	uint16_t idVendor;
+	uint16_t idProduct;
+	uint8_t  bDeviceClass;
+	uint8_t  bDeviceSubClass;
+	uint8_t  bDeviceProtocol;
+};
+
+struct Pipe_struct {
+	Device_t *device;
+	uint8_t  type;		// 0=control, 1=isochronous, 2=bulk, 3=interrupt
+	uint8_t  endpoint;
+	uint8_t  direction;	// 1=IN
+	uint16_t maxlen;
+	void     (*callback_function)(const Transfer_t *);
+};
+
+struct Transfer_struct {
+	struct {
+		uint32_t token;	// bits 16-30: bytes not transferred
+	} qtd;
+	Pipe_t    *pipe;
+	void      *buffer;
+	uint32_t  length;
+	USBDriver *driver;
+};
+
+typedef struct {
+	uint8_t  bmRequestType;
+	uint8_t  bRequest;
+	uint16_t wValue;
+	uint16_t wIndex;
+	uint16_t wLength;
+} setup_t;
+
+typedef struct {
+	uint8_t buffer[64];
+} strbuf_t;
+
+class USBHost {
+	public:
+	static void begin();
+	static void end();
+	static void Task() { }
+	// enumerate the virtual printer, returns true if a driver claimed it
+	static bool connect_printer(uint16_t maxpacket);
+	// debug output is compiled out, as in the Teensy library by default
+	template <typename... Args> static void print_(Args...) { }
+	template <typename... Args> static void println_(Args...) { }
+	static void print_hexbytes(const void *, uint32_t) { }
+	protected:
+	static Pipe_t * new_Pipe(Device_t *dev, uint32_t type, uint32_t endpoint,
+		uint32_t direction, uint32_t maxlen, uint32_t interval=0);
+	static bool queue_Control_Transfer(Device_t *dev, setup_t *setup,
+		void *buf, USBDriver *driver);
+	static bool queue_Data_Transfer(Pipe_t *pipe, void *buffer,
+		uint32_t len, USBDriver *driver);
+	static void contribute_Pipes(Pipe_t *pipes, uint32_t num) { }
+	static void contribute_Transfers(Transfer_t *transfers, uint32_t num) { }
+	static void contribute_String_Buffers(strbuf_t *strbuf, uint32_t num) { }
+	static void driver_ready_for_device(USBDriver *driver);
+	static void mk_setup(setup_t &s, uint32_t bmRequestType, uint32_t bRequest,
+			uint32_t wValue, uint32_t wIndex, uint32_t wLength) {
+		s.bmRequestType = bmRequestType;
+		s.bRequest = bRequest;
+		s.wValue = wValue;
+		s.wIndex = wIndex;
+		s.wLength = wLength;
+	}
+	private:
+	static void isr();
+};
+
+class USBDriver : public USBHost {
+	public:
+	operator bool() { return device != nullptr; }
+	uint16_t idVendor() { return device ? device->idVendor : 0; }
+	uint16_t idProduct() { return device ? device->idProduct : 0; }
+	protected:
+	USBDriver() : device(nullptr) { }
+	virtual bool claim(Device_t *device, int type, const uint8_t *descriptors, uint32_t len) = 0;
+	virtual void control(const Transfer_t *transfer) { }
+	virtual void timer_event(USBDriverTimer *whichTimer) { }
+	virtual void disconnect() { }
+	Device_t *device;
+	friend class USBHost;
+};
+
+class USBDriverTimer {
+	public:
+	USBDriverTimer(USBDriver *d) : driver(d) { }
+	void start(uint32_t microseconds);
+	void stop();
+	USBDriver *driver;
+};
+
+#endif
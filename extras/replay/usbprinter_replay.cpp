@@ -0,0 +1,480 @@
+/* Replay a USBPrinter capture log through the driver on a host
+ *
+ * Build from this directory:
+ *   g++ -O2 -pthread -fpermissive -I. -I../.. usbprinter_replay.cpp ../../USBPrinter_t36.cpp -o usbprinter_replay
+ * (-fpermissive because the driver debug output casts pointers to uint32_t)
+ *
+ * usage: usbprinter_replay [-u usec] [-r] [-t msec] [-o recapture] capture
+ *        usbprinter_replay -g capture [-n records]
+ *   -u usec     time the virtual printer takes to accept each OUT packet (default 0)
+ *   -r          feed records at their captured times instead of full speed
+ *   -t msec     give up and report a stall after this long (default 10000)
+ *   -o file     capture the replayed traffic to a new log
+ *   -g file     write a synthetic log instead of replaying one
+ *   -n records  number of OUT records for -g (default 2000)
+ *
+ * The synthetic log has full 64 byte OUT packets of pseudo random data,
+ * every 7th one short as if sent by the write timer, records 500 us apart
+ * and a 3 byte IN status reply after every 100th OUT record. It is the
+ * same every time, so a replay result can be reproduced:
+ *   ./usbprinter_replay -g synthetic.upc && ./usbprinter_replay synthetic.upc
+ *
+ * The real USBPrinter_t36.cpp is built against the virtual host in
+ * Arduino.h and USBHost_t36.h from this directory. The USB interrupt runs
+ * as a thread and NVIC_DISABLE_IRQ/NVIC_ENABLE_IRQ take a lock. A virtual
+ * printer with 64 byte bulk endpoints completes OUT transfers in order and
+ * answers IN transfers with the IN records from the log.
+ *
+ * The payload of every OUT record is passed to USBPrinter::write() and the
+ * bytes the virtual printer receives must match the captured stream. The
+ * driver may split them into packets differently, packet boundaries depend
+ * on write timing. Queuing an OUT buffer that is still in flight also
+ * counts as a mismatch, real hardware would send corrupted data. Exit
+ * status: 0 match, 1 mismatch, 2 stall, 3 bad usage or log file.
+ *
+ * This example is in the public domain
+ */
+
+#include <Arduino.h>
+#include "USBHost_t36.h"
+#include "USBPrinter_t36.h"
+#include "USBPrinter_capture.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <atomic>
+#include <chrono>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/************************************************************/
+//  Virtual host controller
+/************************************************************/
+
+static std::recursive_mutex irq_lock;
+static const std::chrono::steady_clock::time_point boot = std::chrono::steady_clock::now();
+static std::atomic<bool> isr_running(false);
+static std::thread isr_thread;
+static USBDriver *printer_driver;
+static Device_t printer_device = { 0x0416, 0x5011, 0, 0, 0 };
+static Pipe_t pipes[4];
+static uint32_t num_pipes;
+struct Queued {
+	Transfer_t transfer;
+	uint32_t queued_at;
+};
+static std::deque<Queued> out_queue;
+static std::deque<Queued> in_queue;
+static uint32_t busy_requeued;	// OUT buffers queued again while still in flight
+static USBDriverTimer *timer;
+static bool timer_armed;
+static uint32_t timer_deadline;
+
+void NVIC_DISABLE_IRQ(int irq) { irq_lock.lock(); }
+void NVIC_ENABLE_IRQ(int irq) { irq_lock.unlock(); }
+
+uint32_t micros(void)
+{
+	return std::chrono::duration_cast<std::chrono::microseconds>(
+		std::chrono::steady_clock::now() - boot).count();
+}
+
+void yield(void)
+{
+	std::this_thread::yield();
+}
+
+void USBDriverTimer::start(uint32_t microseconds)
+{
+	std::lock_guard<std::recursive_mutex> lock(irq_lock);
+	timer = this;
+	timer_deadline = micros() + microseconds;
+	timer_armed = true;
+}
+
+void USBDriverTimer::stop()
+{
+	std::lock_guard<std::recursive_mutex> lock(irq_lock);
+	if (timer == this) timer_armed = false;
+}
+
+void USBHost::driver_ready_for_device(USBDriver *driver)
+{
+	printer_driver = driver;
+}
+
+Pipe_t * USBHost::new_Pipe(Device_t *dev, uint32_t type, uint32_t endpoint,
+	uint32_t direction, uint32_t maxlen, uint32_t interval)
+{
+	if (num_pipes >= sizeof(pipes)/sizeof(Pipe_t)) return NULL;
+	Pipe_t *pipe = &pipes[num_pipes++];
+	pipe->device = dev;
+	pipe->type = type;
+	pipe->endpoint = endpoint;
+	pipe->direction = direction;
+	pipe->maxlen = maxlen;
+	pipe->callback_function = NULL;
+	return pipe;
+}
+
+bool USBHost::queue_Control_Transfer(Device_t *dev, setup_t *setup, void *buf, USBDriver *driver)
+{
+	return true;	// SET_INTERFACE and GET_DEVICE_ID are accepted and ignored
+}
+
+bool USBHost::queue_Data_Transfer(Pipe_t *pipe, void *buffer, uint32_t len, USBDriver *driver)
+{
+	std::lock_guard<std::recursive_mutex> lock(irq_lock);
+	Queued q;
+	q.transfer.qtd.token = 0;
+	q.transfer.pipe = pipe;
+	q.transfer.buffer = buffer;
+	q.transfer.length = len;
+	q.transfer.driver = driver;
+	q.queued_at = micros();
+	if (pipe->direction) {
+		in_queue.push_back(q);
+	} else {
+		for (const Queued &o : out_queue) {
+			if (o.transfer.buffer == buffer) busy_requeued++;
+		}
+		out_queue.push_back(q);
+	}
+	return true;
+}
+
+bool USBHost::connect_printer(uint16_t maxpacket)
+{
+	// bi-directional printer interface with one bulk IN and one bulk OUT
+	const uint8_t descriptors[] = {
+		9, 4, 0, 0, 2, 7, 1, 2, 0,
+		7, 5, 0x81, 2, (uint8_t)maxpacket, (uint8_t)(maxpacket >> 8), 0,
+		7, 5, 0x02, 2, (uint8_t)maxpacket, (uint8_t)(maxpacket >> 8), 0
+	};
+	if (!printer_driver) return false;
+	std::lock_guard<std::recursive_mutex> lock(irq_lock);
+	if (!printer_driver->claim(&printer_device, 1, descriptors, sizeof(descriptors))) {
+		return false;
+	}
+	printer_driver->device = &printer_device;
+	return true;
+}
+
+/************************************************************/
+//  Virtual printer
+/************************************************************/
+
+static uint32_t packet_usec;		// time to accept one OUT packet
+static std::vector<uint8_t> received;	// everything the printer accepted
+static uint32_t out_packets;
+static uint32_t last_done;		// time of the last OUT completion
+static uint32_t longest_gap;		// longest time between OUT completions
+static std::deque<uint8_t> status;	// IN data waiting for the host
+static uint32_t in_bytes;
+
+void USBHost::isr()
+{
+	while (isr_running) {
+		{
+			std::lock_guard<std::recursive_mutex> lock(irq_lock);
+			uint32_t now = micros();
+			// OUT transfers complete in order, each one taking packet_usec
+			if (!out_queue.empty()) {
+				Queued &q = out_queue.front();
+				uint32_t start = q.queued_at;
+				if (out_packets && (int32_t)(last_done - start) > 0) start = last_done;
+				if ((int32_t)(now - start) >= (int32_t)packet_usec) {
+					Transfer_t t = q.transfer;
+					out_queue.pop_front();
+					const uint8_t *p = (const uint8_t *)t.buffer;
+					received.insert(received.end(), p, p + t.length);
+					if (out_packets && now - last_done > longest_gap) {
+						longest_gap = now - last_done;
+					}
+					last_done = now;
+					out_packets++;
+					if (t.pipe->callback_function) t.pipe->callback_function(&t);
+				}
+			}
+			// IN transfers complete when the printer has something to say
+			if (!in_queue.empty() && !status.empty()) {
+				Transfer_t t = in_queue.front().transfer;
+				in_queue.pop_front();
+				uint32_t n = 0;
+				uint8_t *p = (uint8_t *)t.buffer;
+				while (n < t.length && !status.empty()) {
+					p[n++] = status.front();
+					status.pop_front();
+				}
+				t.qtd.token = (t.length - n) << 16;
+				in_bytes += n;
+				if (t.pipe->callback_function) t.pipe->callback_function(&t);
+			}
+			if (timer_armed && (int32_t)(now - timer_deadline) >= 0) {
+				timer_armed = false;
+				timer->driver->timer_event(timer);
+			}
+		}
+		std::this_thread::yield();
+	}
+}
+
+void USBHost::begin()
+{
+	isr_running = true;
+	isr_thread = std::thread(isr);
+}
+
+void USBHost::end()
+{
+	isr_running = false;
+	if (isr_thread.joinable()) isr_thread.join();
+}
+
+/************************************************************/
+//  Replay
+/************************************************************/
+
+struct Record {
+	uint32_t timestamp;
+	uint8_t dir;
+	std::vector<uint8_t> data;
+};
+
+struct FileOut {
+	FILE *f;
+	size_t write(const uint8_t *buffer, size_t size) { return fwrite(buffer, 1, size, f); }
+};
+
+static bool load(const char *filename, std::vector<Record> &records)
+{
+	FILE *f = fopen(filename, "rb");
+	if (!f) {
+		perror(filename);
+		return false;
+	}
+	uint8_t hdr[USBPrinterCapture::RECORD_HEADER_SIZE];
+	if (fread(hdr, 1, 4, f) != 4 || memcmp(hdr, "UPC1", 4) != 0) {
+		fprintf(stderr, "%s: not a USBPrinter capture log\n", filename);
+		fclose(f);
+		return false;
+	}
+	while (fread(hdr, 1, sizeof(hdr), f) == sizeof(hdr)) {
+		Record r;
+		r.timestamp = hdr[0] | (hdr[1] << 8) | (hdr[2] << 16) | ((uint32_t)hdr[3] << 24);
+		uint32_t len = hdr[4] | (hdr[5] << 8);
+		r.dir = (len & USBPrinterCapture::LENGTH_IN) ? USBPrinterCapture::DIR_IN : USBPrinterCapture::DIR_OUT;
+		r.data.resize(len & USBPrinterCapture::MAX_PAYLOAD);
+		if (fread(r.data.data(), 1, r.data.size(), f) != r.data.size()) {
+			fprintf(stderr, "%s: truncated record ignored\n", filename);
+			break;
+		}
+		records.push_back(r);
+	}
+	fclose(f);
+	return true;
+}
+
+static bool generate(const char *filename, uint32_t count)
+{
+	std::vector<uint8_t> logbuf(count * (USBPrinterCapture::RECORD_HEADER_SIZE + 64) * 2 + 1024);
+	USBPrinterCapture log(logbuf.data(), logbuf.size());
+	uint32_t seed = 1;
+	uint32_t timestamp = 0;
+	uint8_t packet[64];
+	for (uint32_t i = 0; i < count; i++) {
+		seed = seed * 1103515245 + 12345;
+		uint32_t len = (i % 7 == 6) ? ((seed >> 16) % 63) + 1 : 64;
+		for (uint32_t j = 0; j < len; j++) {
+			seed = seed * 1103515245 + 12345;
+			packet[j] = seed >> 16;
+		}
+		log.record(timestamp, USBPrinterCapture::DIR_OUT, packet, len);
+		timestamp += 500;
+		if (i % 100 == 0) {
+			const uint8_t reply[3] = { 0x10, 0x04, (uint8_t)(i / 100) };	// DLE EOT n
+			log.record(timestamp, USBPrinterCapture::DIR_IN, reply, sizeof(reply));
+		}
+	}
+	FILE *f = fopen(filename, "wb");
+	if (!f) {
+		perror(filename);
+		return false;
+	}
+	FileOut out = { f };
+	log.drain(out);
+	fclose(f);
+	printf("%s: %u OUT records\n", filename, count);
+	return true;
+}
+
+static void usage()
+{
+	fprintf(stderr, "usage: usbprinter_replay [-u usec] [-r] [-t msec] [-o recapture] capture\n"
+		"       usbprinter_replay -g capture [-n records]\n");
+	exit(3);
+}
+
+USBHost myusb;
+USBPrinter uprinter(myusb);
+
+// Largest single write() while feeding, one virtual printer packet. While
+// less than this is free at least one full packet is waiting to go out,
+// so waiting for space cannot depend on the write timer.
+static const size_t FEED_CHUNK = 64;
+
+int main(int argc, char **argv)
+{
+	bool realtime = false;
+	uint32_t timeout_ms = 10000;
+	const char *recapture = NULL;
+	bool gen = false;
+	uint32_t gen_count = 2000;
+	int opt;
+	while ((opt = getopt(argc, argv, "u:rt:o:gn:")) != -1) {
+		switch (opt) {
+			case 'u': packet_usec = strtoul(optarg, NULL, 0); break;
+			case 'r': realtime = true; break;
+			case 't': timeout_ms = strtoul(optarg, NULL, 0); break;
+			case 'o': recapture = optarg; break;
+			case 'g': gen = true; break;
+			case 'n': gen_count = strtoul(optarg, NULL, 0); break;
+			default: usage();
+		}
+	}
+	if (optind != argc - 1) usage();
+	if (gen) return generate(argv[optind], gen_count) ? 0 : 3;
+
+	std::vector<Record> records;
+	if (!load(argv[optind], records)) return 3;
+	std::vector<uint8_t> expected;
+	uint32_t captured_packets = 0;
+	uint32_t captured_in = 0;
+	for (const Record &r : records) {
+		if (r.dir == USBPrinterCapture::DIR_OUT) {
+			expected.insert(expected.end(), r.data.begin(), r.data.end());
+			captured_packets++;
+		} else {
+			captured_in += r.data.size();
+		}
+	}
+
+	std::vector<uint8_t> capbuf;
+	USBPrinterCapture *capture = NULL;
+	if (recapture) {
+		capbuf.resize((expected.size() + captured_in) * 2 + records.size() * 16 + 1024);
+		capture = new USBPrinterCapture(capbuf.data(), capbuf.size());
+		uprinter.setCapture(capture);
+	}
+
+	myusb.begin();
+	if (!USBHost::connect_printer(64)) {
+		fprintf(stderr, "virtual printer not claimed\n");
+		_exit(3);
+	}
+	uprinter.begin();
+
+	// feed the log from its own thread so a driver stall can be detected
+	std::atomic<bool> done(false);
+	uint32_t start = micros();
+	std::thread feeder([&] {
+		uint32_t first = records.empty() ? 0 : records[0].timestamp;
+		for (const Record &r : records) {
+			if (realtime) {
+				while (micros() - start < r.timestamp - first) yield();
+			}
+			if (r.dir == USBPrinterCapture::DIR_OUT) {
+				// Wait for ring space here with yield(). Inside write() the
+				// driver busy waits, which on a single CPU holds off the
+				// virtual host thread until the scheduler preempts it.
+				const uint8_t *p = r.data.data();
+				size_t left = r.data.size();
+				while (left > 0) {
+					size_t n = (left < FEED_CHUNK) ? left : FEED_CHUNK;
+					while ((size_t)uprinter.availableForWrite() < n) yield();
+					uprinter.write(p, n);
+					p += n;
+					left -= n;
+				}
+			} else {
+				NVIC_DISABLE_IRQ(IRQ_USBHS);
+				status.insert(status.end(), r.data.begin(), r.data.end());
+				NVIC_ENABLE_IRQ(IRQ_USBHS);
+			}
+			while (uprinter.available()) uprinter.read();
+		}
+		// flush() busy waits too, so let the queued packets drain first
+		// and leave it only the final partial packet
+		bool drained = false;
+		while (!drained) {
+			NVIC_DISABLE_IRQ(IRQ_USBHS);
+			drained = out_queue.empty();
+			NVIC_ENABLE_IRQ(IRQ_USBHS);
+			if (!drained) yield();
+		}
+		uprinter.flush();
+		done = true;
+	});
+	// flush() may return before its timer sends the last partial packet,
+	// so also wait for the bus to go idle
+	bool idle = false;
+	while (!idle && micros() - start < timeout_ms * 1000) {
+		std::this_thread::sleep_for(std::chrono::milliseconds(1));
+		NVIC_DISABLE_IRQ(IRQ_USBHS);
+		idle = done && out_queue.empty() && !timer_armed;
+		NVIC_ENABLE_IRQ(IRQ_USBHS);
+	}
+
+	NVIC_DISABLE_IRQ(IRQ_USBHS);
+	uint32_t elapsed = (out_packets ? last_done : micros()) - start;
+	printf("records:        %u (%u OUT, %u bytes IN)\n", (unsigned)records.size(),
+		captured_packets, captured_in);
+	printf("OUT packets:    %u captured, %u replayed\n", captured_packets, out_packets);
+	printf("OUT bytes:      %u captured, %u received\n", (unsigned)expected.size(),
+		(unsigned)received.size());
+	printf("IN bytes:       %u delivered\n", in_bytes);
+	printf("elapsed:        %.3f ms\n", elapsed / 1000.0);
+	if (elapsed) printf("throughput:     %.1f KB/s\n", received.size() * 1000.0 / elapsed);
+	printf("longest gap:    %u us between OUT packets\n", longest_gap);
+	printf("busy requeued:  %u OUT buffers queued again while in flight\n", busy_requeued);
+	int result = 0;
+	if (!idle) {
+		printf("result:         STALL after %u of %u bytes\n", (unsigned)received.size(),
+			(unsigned)expected.size());
+		result = 2;
+	} else {
+		size_t i = 0;
+		while (i < expected.size() && i < received.size() && expected[i] == received[i]) i++;
+		if (i != expected.size() || i != received.size()) {
+			printf("result:         MISMATCH at byte %u\n", (unsigned)i);
+			result = 1;
+		} else if (busy_requeued) {
+			printf("result:         MISMATCH, busy OUT buffer requeued\n");
+			result = 1;
+		} else {
+			printf("result:         OK\n");
+		}
+	}
+	NVIC_ENABLE_IRQ(IRQ_USBHS);
+
+	if (capture) {
+		FILE *f = fopen(recapture, "wb");
+		if (f) {
+			FileOut out = { f };
+			NVIC_DISABLE_IRQ(IRQ_USBHS);
+			capture->drain(out);
+			NVIC_ENABLE_IRQ(IRQ_USBHS);
+			fclose(f);
+		} else {
+			perror(recapture);
+		}
+		if (capture->dropped()) printf("recapture dropped %u records\n", capture->dropped());
+	}
+	fflush(stdout);
+	if (result == 2) _exit(result);	// the driver may be spinning in write() or flush()
+	feeder.join();
+	myusb.end();
+	return result;
+}